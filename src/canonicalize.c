@@ -20,15 +20,42 @@
  *
  * TODO: use canonicalize_file_name() when exist in glibc
  */
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE	/* O_PATH, strchrnul */
+#endif
 #include <stdio.h>
 #include <string.h>
 #include <ctype.h>
 #include <unistd.h>
 #include <errno.h>
 #include <stdlib.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <dirent.h>
 
 #include "canonicalize.h"
 
+#ifndef O_PATH
+# define O_PATH 010000000
+#endif
+
+/* openat2() is not wrapped by glibc; use the syscall when the headers know
+ * its number.  The struct and flags are from <linux/openat2.h>. */
+#ifdef SYS_openat2
+struct udevil_open_how {
+	unsigned long long flags;
+	unsigned long long mode;
+	unsigned long long resolve;
+};
+# ifndef RESOLVE_NO_MAGICLINKS
+#  define RESOLVE_NO_MAGICLINKS	0x02
+# endif
+# ifndef RESOLVE_NO_SYMLINKS
+#  define RESOLVE_NO_SYMLINKS	0x04
+# endif
+#endif
+
 #ifndef MAXSYMLINKS
 # define MAXSYMLINKS 256
 #endif
@@ -139,19 +166,68 @@ myrealpath(const char *path, char *resolved_path, int maxreslth) {
 }
 
 /*
- * Converts private "dm-N" names to "/dev/mapper/<name>"
- *
- * Since 2.6.29 (patch 784aae735d9b0bba3f8b9faef4c8b30df3bf0128) kernel sysfs
- * provides the real DM device names in /sys/block/<ptname>/dm/name
+ * Root of the /proc, /sys and /etc files udevil reads.  Only udevil-bench
+ * can move it, to a fabricated tree; the installed program always reads the
+ * real files.  udevil-bench replay also reads the mount table from its own
+ * copy (path_mountinfo), so the tree is left as it was.
  */
-char *
-canonicalize_dm_name(const char *ptname)
+#ifdef TEST_PROGRAM_BENCH
+const char *path_root = "";
+const char *path_mountinfo = NULL;
+# define PATH_ROOT	path_root
+#else
+# define PATH_ROOT	""
+#endif
+
+/*
+ * Returns path under the root - path itself when the root is /, else the
+ * prefixed path written to buf.
+ */
+const char *
+root_path(const char *path, char *buf, size_t size)
+{
+#ifdef TEST_PROGRAM_BENCH
+	if (path_mountinfo && !strcmp(path, "/proc/self/mountinfo"))
+		return path_mountinfo;
+#endif
+	if (!*PATH_ROOT)
+		return path;
+	snprintf(buf, size, "%s%s", PATH_ROOT, path);
+	return buf;
+}
+
+/*
+ * dm-N -> "/dev/mapper/<name>" map, indexed by N.  Entries are filled one at
+ * a time as they are looked up, so a one-shot command reads only the names
+ * it needs.  Long-lived modes fill it in one pass over /sys/block with
+ * dm_name_cache_load() and keep it fresh from udev events via
+ * dm_name_cache_refresh().
+ */
+static char **dm_names;
+static int dm_names_len;
+static int dm_names_loaded;
+
+static int
+dm_index(const char *ptname)
+{
+	char *end;
+	long n;
+
+	if (strncmp(ptname, "dm-", 3) != 0 || !isdigit(ptname[3]))
+		return -1;
+	n = strtol(ptname + 3, &end, 10);
+	return (*end == '\0' && n < 1 << 20) ? (int)n : -1;
+}
+
+static char *
+read_dm_name(const char *ptname)
 {
 	FILE	*f;
 	size_t	sz;
-	char	path[256], name[256], *res = NULL;
+	char	path[PATH_MAX], name[256], *res = NULL;
 
-	snprintf(path, sizeof(path), "/sys/block/%s/dm/name", ptname);
+	snprintf(path, sizeof(path), "%s/sys/block/%s/dm/name", PATH_ROOT,
+								ptname);
 	if (!(f = fopen(path, "r")))
 		return NULL;
 
@@ -165,6 +241,113 @@ canonicalize_dm_name(const char *ptname)
 	return res;
 }
 
+static void
+dm_name_set(int n, char *mapper)
+{
+	char **names;
+	int len;
+
+	if (n >= dm_names_len) {
+		if (!mapper)
+			return;
+		len = n < 64 ? 64 : n * 2;
+		names = realloc(dm_names, len * sizeof(char *));
+		if (!names) {
+			free(mapper);
+			return;
+		}
+		memset(names + dm_names_len, 0,
+				(len - dm_names_len) * sizeof(char *));
+		dm_names = names;
+		dm_names_len = len;
+	}
+	free(dm_names[n]);
+	dm_names[n] = mapper;
+}
+
+/*
+ * Reads every /sys/block/dm-N/dm/name into the map.  Returns the number of
+ * names, or -1 if /sys/block cannot be read.
+ */
+int
+dm_name_cache_load(void)
+{
+	DIR *dir;
+	struct dirent *ent;
+	char path[PATH_MAX];
+	int n, count = 0;
+
+	if (!(dir = opendir(root_path("/sys/block", path, sizeof(path)))))
+		return -1;
+	while ((ent = readdir(dir))) {
+		if ((n = dm_index(ent->d_name)) == -1)
+			continue;
+		dm_name_set(n, read_dm_name(ent->d_name));
+		count++;
+	}
+	closedir(dir);
+	dm_names_loaded = 1;
+	return count;
+}
+
+/*
+ * Updates one entry after a udev event for ptname ("dm-N") - re-read from
+ * sysfs on add/change, dropped on remove.
+ */
+void
+dm_name_cache_refresh(const char *ptname, int removed)
+{
+	int n = dm_index(ptname);
+
+	if (n != -1 && dm_names_loaded)
+		dm_name_set(n, removed ? NULL : read_dm_name(ptname));
+}
+
+/*
+ * Returns the number of names held.
+ */
+int
+dm_name_cache_count(void)
+{
+	int n, count = 0;
+
+	for (n = 0; n < dm_names_len; n++)
+		count += dm_names[n] != NULL;
+	return count;
+}
+
+void
+dm_name_cache_free(void)
+{
+	int n;
+
+	for (n = 0; n < dm_names_len; n++)
+		free(dm_names[n]);
+	free(dm_names);
+	dm_names = NULL;
+	dm_names_len = 0;
+	dm_names_loaded = 0;
+}
+
+/*
+ * Converts private "dm-N" names to "/dev/mapper/<name>"
+ *
+ * Since 2.6.29 (patch 784aae735d9b0bba3f8b9faef4c8b30df3bf0128) kernel sysfs
+ * provides the real DM device names in /sys/block/<ptname>/dm/name
+ */
+char *
+canonicalize_dm_name(const char *ptname)
+{
+	int n = dm_index(ptname);
+
+	if (n == -1)
+		return read_dm_name(ptname);
+	if (n >= dm_names_len || !dm_names[n])
+		/* not looked up yet, or created since the map was loaded */
+		dm_name_set(n, read_dm_name(ptname));
+	return (n < dm_names_len && dm_names[n]) ? strdup(dm_names[n]) : NULL;
+}
+
 char *
 canonicalize_path(const char *path)
 {
@@ -188,6 +371,152 @@ canonicalize_path(const char *path)
 	return strdup(canonical);
 }
 
+/*
+ * Returns the path the kernel resolved for an open fd, read back from
+ * /proc/self/fd, with "dm-N" converted as in canonicalize_path().  NULL if
+ * /proc is not mounted or the file has no name (deleted, pipe, socket).
+ */
+char *
+canonicalize_fd(int fd)
+{
+	char path[64], target[PATH_MAX+1], *p;
+	ssize_t n;
+
+	snprintf(path, sizeof(path), "/proc/self/fd/%d", fd);
+	n = readlink(path, target, PATH_MAX);
+	if (n <= 0 || target[0] != '/')
+		return NULL;
+	target[n] = '\0';
+	if (n > 10 && strcmp(target + n - 10, " (deleted)") == 0)
+		return NULL;
+
+	p = strrchr(target, '/');
+	if (p && strncmp(p, "/dm-", 4) == 0 && isdigit(*(p + 4))) {
+		p = canonicalize_dm_name(p+1);
+		if (p)
+			return p;
+	}
+	return strdup(target);
+}
+
+/*
+ * Same result as canonicalize_path(), but lets the kernel resolve the path
+ * in one open() instead of a readlink() per component.  Paths which cannot
+ * be opened (missing, no permission) take the old route.
+ */
+char *
+canonicalize_path_fd(const char *path)
+{
+	char *res;
+	int fd;
+
+	if (path == NULL)
+		return NULL;
+
+	fd = open(path, O_PATH | O_CLOEXEC);
+	if (fd == -1)
+		return canonicalize_path(path);
+	res = canonicalize_fd(fd);
+	close(fd);
+	return res ? res : canonicalize_path(path);
+}
+
+/*
+ * Opens an absolute path with O_PATH, failing with ELOOP if any component
+ * is a symlink.  Uses openat2(RESOLVE_NO_SYMLINKS) where the kernel has it
+ * (5.6+), else walks the components with O_NOFOLLOW.  Returns the fd or -1.
+ */
+int
+open_path_nofollow(const char *path)
+{
+	char name[PATH_MAX+1];
+	const char *c, *end;
+	struct stat st;
+	int dirfd, fd;
+
+	if (path == NULL || *path != '/') {
+		errno = EINVAL;
+		return -1;
+	}
+
+#ifdef SYS_openat2
+	struct udevil_open_how how = { 0 };
+	how.flags = O_PATH | O_CLOEXEC;
+	how.resolve = RESOLVE_NO_SYMLINKS | RESOLVE_NO_MAGICLINKS;
+	fd = syscall(SYS_openat2, AT_FDCWD, path, &how, sizeof(how));
+	if (fd != -1 || (errno != ENOSYS && errno != EPERM))
+		return fd;
+	/* ENOSYS: old kernel, EPERM: seccomp filter */
+#endif
+
+	dirfd = open("/", O_PATH | O_CLOEXEC | O_DIRECTORY);
+	for (c = path; dirfd != -1; c = end) {
+		while (*c == '/')
+			c++;
+		if (*c == '\0')
+			return dirfd;
+		end = strchrnul(c, '/');
+		if (end - c > PATH_MAX) {
+			close(dirfd);
+			errno = ENAMETOOLONG;
+			return -1;
+		}
+		memcpy(name, c, end - c);
+		name[end - c] = '\0';
+		fd = openat(dirfd, name, O_PATH | O_CLOEXEC | O_NOFOLLOW);
+		close(dirfd);
+		if (fd != -1 && (fstat(fd, &st) == -1 || S_ISLNK(st.st_mode))) {
+			close(fd);
+			errno = ELOOP;
+			return -1;
+		}
+		dirfd = fd;
+	}
+	return -1;
+}
+
+/*
+ * Returns 1 if canonicalize_path(path) would return path unchanged.  A
+ * normalized absolute path which opens without crossing a symlink is
+ * canonical without reading any links; anything else is decided by
+ * canonicalize_path().
+ */
+int
+is_canonical_path(const char *path)
+{
+	const char *p;
+	char *res;
+	int fd, ret;
+
+	if (path == NULL || *path == '\0')
+		return 0;
+
+	/* no //, /./, /../ or trailing / - and no dm-N, which maps to a name */
+	ret = *path == '/' && (path[1] == '\0' || path[strlen(path) - 1] != '/');
+	for (p = path; ret && (p = strchr(p, '/')); p++) {
+		if (p[1] == '/' ||
+		    (p[1] == '.' && (p[2] == '/' || p[2] == '\0')) ||
+		    (p[1] == '.' && p[2] == '.' && (p[3] == '/' || p[3] == '\0')))
+			ret = 0;
+	}
+	p = strrchr(path, '/');
+	if (ret && p && strncmp(p, "/dm-", 4) == 0 && isdigit(*(p + 4)))
+		ret = 0;
+
+	if (ret) {
+		fd = open_path_nofollow(path);
+		if (fd != -1) {
+			close(fd);
+			return 1;
+		}
+	}
+
+	res = canonicalize_path(path);
+	ret = res && strcmp(res, path) == 0;
+	free(res);
+	return ret;
+}
+
 
 #ifdef TEST_PROGRAM_CANONICALIZE
 int main(int argc, char **argv)
@@ -199,6 +528,9 @@ int main(int argc, char **argv)
 
 	fprintf(stdout, "orig: %s\n", argv[1]);
 	fprintf(stdout, "real: %s\n", canonicalize_path(argv[1]));
+	fprintf(stdout, "fd:   %s\n", canonicalize_path_fd(argv[1]));
+	fprintf(stdout, "canonical: %s\n",
+			is_canonical_path(argv[1]) ? "yes" : "no");
 
 	exit(EXIT_SUCCESS);
 }
@@ -3,8 +3,23 @@
 
 //#include "c.h"	/* for PATH_MAX */
 #include <limits.h>		/* for PATH_MAX */
+#include <stddef.h>
+
+#ifdef TEST_PROGRAM_BENCH
+extern const char *path_root;
+extern const char *path_mountinfo;
+#endif
 
 extern char *canonicalize_path(const char *path);
 extern char *canonicalize_dm_name(const char *ptname);
+extern int dm_name_cache_load(void);
+extern void dm_name_cache_refresh(const char *ptname, int removed);
+extern int dm_name_cache_count(void);
+extern void dm_name_cache_free(void);
+extern char *canonicalize_fd(int fd);
+extern char *canonicalize_path_fd(const char *path);
+extern int open_path_nofollow(const char *path);
+extern int is_canonical_path(const char *path);
+extern const char *root_path(const char *path, char *buf, size_t size);
 
 #endif /* CANONICALIZE_H */
@@ -4,6 +4,10 @@
 ************************************************************************** */
 
 #include "device-info.h"
+#include "canonicalize.h"
+
+#include <sys/ioctl.h>
+#include <linux/cdrom.h>
 
 static char *
 _dupv8 (const char *s)
@@ -80,6 +84,18 @@ ptr_str_array_compare (const gchar **a,
   return g_strcmp0 (*a, *b);
 }
 
+unsigned long file_reads = 0;
+
+gboolean
+read_file_contents (const char *path,
+                    gchar **contents,
+                    GError **error)
+{
+  /* g_file_get_contents counted in file_reads */
+  file_reads++;
+  return g_file_get_contents (path, contents, NULL, error);
+}
+
 static double
 sysfs_get_double (const char *dir,
                   const char *attribute)
@@ -90,7 +106,7 @@ sysfs_get_double (const char *dir,
 
   result = 0.0;
   filename = g_build_filename (dir, attribute, NULL);
-  if (g_file_get_contents (filename, &contents, NULL, NULL))
+  if (read_file_contents (filename, &contents, NULL))
     {
       result = atof (contents);
       g_free (contents);
@@ -109,7 +125,7 @@ sysfs_get_string (const char *dir,
 
   result = NULL;
   filename = g_build_filename (dir, attribute, NULL);
-  if (!g_file_get_contents (filename, &result, NULL, NULL))
+  if (!read_file_contents (filename, &result, NULL))
     {
       result = g_strdup ("");
     }
@@ -128,7 +144,7 @@ sysfs_get_int (const char *dir,
 
   result = 0;
   filename = g_build_filename (dir, attribute, NULL);
-  if (g_file_get_contents (filename, &contents, NULL, NULL))
+  if (read_file_contents (filename, &contents, NULL))
     {
       result = strtol (contents, NULL, 0);
       g_free (contents);
@@ -148,7 +164,7 @@ sysfs_get_uint64 (const char *dir,
 
   result = 0;
   filename = g_build_filename (dir, attribute, NULL);
-  if (g_file_get_contents (filename, &contents, NULL, NULL))
+  if (read_file_contents (filename, &contents, NULL))
     {
       result = strtoll (contents, NULL, 0);
       g_free (contents);
@@ -691,6 +707,53 @@ void info_drive_properties ( device_t *device )
     device->drive_can_detach = drive_can_detach;
 }
 
+static gboolean info_media_available( struct udev_device *udevice,
+                                      const char *devnode,
+                                      gboolean removable,
+                                      gboolean has_id )
+{
+    const char* value;
+    gboolean media_available = FALSE;
+
+    if ( has_id )
+        media_available = TRUE;
+    else if ( g_str_has_prefix( devnode, "/dev/loop" ) )
+        media_available = FALSE;
+    else if ( removable )
+    {
+        gboolean is_cd, is_floppy;
+        if ( value = udev_device_get_property_value( udevice, "ID_CDROM" ) )
+            is_cd = atoi( value ) != 0;
+        else
+            is_cd = FALSE;
+
+        if ( value = udev_device_get_property_value( udevice, "ID_DRIVE_FLOPPY" ) )
+            is_floppy = atoi( value ) != 0;
+        else
+            is_floppy = FALSE;
+
+        if ( !is_cd && !is_floppy )
+        {
+            // this test is limited for non-root - user may not have read
+            // access to device file even if media is present
+            int fd;
+            fd = open( devnode, O_RDONLY );
+            if ( fd >= 0 )
+            {
+                media_available = TRUE;
+                close( fd );
+            }
+        }
+        else if ( value = udev_device_get_property_value( udevice, "ID_CDROM_MEDIA" ) )
+            media_available = ( atoi( value ) == 1 );
+    }
+    else if ( value = udev_device_get_property_value( udevice, "ID_CDROM_MEDIA" ) )
+        media_available = ( atoi( value ) == 1 );
+    else
+        media_available = TRUE;
+    return media_available;
+}
+
 void info_device_properties( device_t *device )
 {
     const char* value;
@@ -707,8 +770,6 @@ void info_device_properties( device_t *device )
         return;
     }
 
-    //by id - would need to read symlinks in /dev/disk/by-id
-
     // is_removable may also be set in info_drive_connection walking up sys tree
     device->device_is_removable = sysfs_get_int( device->native_path, "removable");
 
@@ -760,50 +821,12 @@ void info_device_properties( device_t *device )
     }
 
     // device_is_media_available
-    gboolean media_available = FALSE;
-
-    if ( ( device->id_usage && device->id_usage[0] != '\0' ) ||
-         ( device->id_type  && device->id_type[0]  != '\0' ) ||
-         ( device->id_uuid  && device->id_uuid[0]  != '\0' ) ||
-         ( device->id_label && device->id_label[0] != '\0' ) )
-    {
-         media_available = TRUE;
-    }
-    else if ( g_str_has_prefix( device->devnode, "/dev/loop" ) )
-        media_available = FALSE;
-    else if ( device->device_is_removable )
-    {
-        gboolean is_cd, is_floppy;
-        if ( value = udev_device_get_property_value( device->udevice, "ID_CDROM" ) )
-            is_cd = atoi( value ) != 0;
-        else
-            is_cd = FALSE;
-
-        if ( value = udev_device_get_property_value( device->udevice, "ID_DRIVE_FLOPPY" ) )
-            is_floppy = atoi( value ) != 0;
-        else
-            is_floppy = FALSE;
-
-        if ( !is_cd && !is_floppy )
-        {
-            // this test is limited for non-root - user may not have read
-            // access to device file even if media is present
-            int fd;
-            fd = open( device->devnode, O_RDONLY );
-            if ( fd >= 0 )
-            {
-                media_available = TRUE;
-                close( fd );
-            }
-        }
-        else if ( value = udev_device_get_property_value( device->udevice, "ID_CDROM_MEDIA" ) )
-            media_available = ( atoi( value ) == 1 );
-    }
-    else if ( value = udev_device_get_property_value( device->udevice, "ID_CDROM_MEDIA" ) )
-        media_available = ( atoi( value ) == 1 );
-    else
-        media_available = TRUE;
-    device->device_is_media_available = media_available;
+    device->device_is_media_available = info_media_available( device->udevice,
+                device->devnode, device->device_is_removable,
+                ( device->id_usage && device->id_usage[0] != '\0' ) ||
+                ( device->id_type  && device->id_type[0]  != '\0' ) ||
+                ( device->id_uuid  && device->id_uuid[0]  != '\0' ) ||
+                ( device->id_label && device->id_label[0] != '\0' ) );
 
     /* device_size, device_block_size and device_is_read_only properties */
     if (device->device_is_media_available)
@@ -848,6 +871,7 @@ void info_device_properties( device_t *device )
 
 gchar* info_mount_points( device_t *device, GList* devmounts )
 {
+    char path[PATH_MAX];
     gchar *contents;
     gchar **lines;
     GError *error;
@@ -878,7 +902,8 @@ gchar* info_mount_points( device_t *device, GList* devmounts )
     lines = NULL;
 
     error = NULL;
-    if (!g_file_get_contents ("/proc/self/mountinfo", &contents, NULL, &error))
+    if (!read_file_contents (root_path( "/proc/self/mountinfo", path, sizeof( path ) ),
+                                                    &contents, &error))
     {
         g_warning ("Error reading /proc/self/mountinfo: %s", error->message);
         g_error_free (error);
@@ -1200,6 +1225,65 @@ void info_optical_disc( device_t *device )
         device->device_is_optical_disc = FALSE;
 }
 
+gboolean device_probe_optical( device_t *device )
+{
+    /* udev only updates ID_CDROM_MEDIA_* on a media change event, so ask the
+     * drive directly.  O_NONBLOCK opens without waiting for media and neither
+     * ioctl spins up the disc.  Returns FALSE if the drive gave no answer, in
+     * which case the udev state is left as is. */
+    int fd;
+    int status;
+    struct cdrom_tochdr tochdr;
+
+    if ( !device->device_is_optical_disc || !device->devnode )
+        return FALSE;
+    fd = open( device->devnode, O_RDONLY | O_NONBLOCK );
+    if ( fd < 0 )
+        return FALSE;
+
+    status = ioctl( fd, CDROM_DRIVE_STATUS, CDSL_CURRENT );
+    if ( status == CDS_NO_DISC || status == CDS_TRAY_OPEN )
+    {
+        device->device_is_media_available = FALSE;
+        device->optical_disc_is_blank = FALSE;
+        device->optical_disc_is_appendable = FALSE;
+        device->optical_disc_is_closed = FALSE;
+        g_free( device->optical_disc_num_tracks );
+        g_free( device->optical_disc_num_audio_tracks );
+        g_free( device->optical_disc_num_sessions );
+        device->optical_disc_num_tracks = NULL;
+        device->optical_disc_num_audio_tracks = NULL;
+        device->optical_disc_num_sessions = NULL;
+    }
+    else if ( status == CDS_DISC_OK )
+    {
+        device->device_is_media_available = TRUE;
+        // an audio disc inserted since the last udev event has no counts yet
+        if ( ioctl( fd, CDROM_DISC_STATUS, 0 ) == CDS_AUDIO &&
+                        !( device->optical_disc_num_audio_tracks &&
+                           atoi( device->optical_disc_num_audio_tracks ) > 0 ) &&
+                        ioctl( fd, CDROMREADTOCHDR, &tochdr ) == 0 &&
+                        tochdr.cdth_trk1 >= tochdr.cdth_trk0 )
+        {
+            g_free( device->optical_disc_num_tracks );
+            g_free( device->optical_disc_num_audio_tracks );
+            device->optical_disc_num_tracks = g_strdup_printf( "%d",
+                                    tochdr.cdth_trk1 - tochdr.cdth_trk0 + 1 );
+            device->optical_disc_num_audio_tracks = g_strdup(
+                                    device->optical_disc_num_tracks );
+            device->optical_disc_is_blank = FALSE;
+        }
+    }
+    else
+    {
+        // CDS_DRIVE_NOT_READY, CDS_NO_INFO or error
+        close( fd );
+        return FALSE;
+    }
+    close( fd );
+    return TRUE;
+}
+
 void device_free( device_t *device )
 {
     if ( !device )
@@ -1335,122 +1419,591 @@ gboolean device_get_info( device_t *device, GList* devmounts )
     return TRUE;
 }
 
-char* device_show_info( device_t *device )
-{   // no translate
-    gchar* line[140];
-    int i = 0;
-
-    //line[i++] = g_strdup_printf("Showing information for %s\n", device->devnode );
-    char* bdev = g_path_get_basename( device->devnode );
-    line[i++] = g_strdup_printf("Showing information for /org/freedesktop/UDisks/devices/%s\n", bdev );
-    g_free( bdev );
-    line[i++] = g_strdup_printf("  native-path:                 %s\n", device->native_path );
-    line[i++] = g_strdup_printf("  device:                      %s:%s\n", device->major, device->minor );
-    line[i++] = g_strdup_printf("  device-file:                 %s\n", device->devnode );
-    line[i++] = g_strdup_printf("    presentation:              %s\n", device->devnode );
-    if ( device->device_by_id )
-        line[i++] = g_strdup_printf("    by-id:                     %s\n", device->device_by_id );
-    line[i++] = g_strdup_printf("  system internal:             %d\n", device->device_is_system_internal );
-    line[i++] = g_strdup_printf("  removable:                   %d\n", device->device_is_removable);
-    line[i++] = g_strdup_printf("  has media:                   %d\n", device->device_is_media_available);
-    line[i++] = g_strdup_printf("  is read only:                %d\n", device->device_is_read_only );
-    line[i++] = g_strdup_printf("  is mounted:                  %d\n", device->device_is_mounted );
-    line[i++] = g_strdup_printf("  mount paths:                 %s\n", device->mount_points ? device->mount_points : "" );
-    line[i++] = g_strdup_printf("  presentation hide:           %s\n", device->device_presentation_hide ?
-                                                device->device_presentation_hide : "0" );
-    line[i++] = g_strdup_printf("  presentation nopolicy:       %s\n", device->device_presentation_nopolicy ?
-                                                device->device_presentation_nopolicy : "0" );
-    line[i++] = g_strdup_printf("  presentation name:           %s\n", device->device_presentation_name ?
-                                                device->device_presentation_name : "" );
-    line[i++] = g_strdup_printf("  presentation icon:           %s\n", device->device_presentation_icon_name ?
-                                                device->device_presentation_icon_name : "" );
-    line[i++] = g_strdup_printf("  automount hint:              %s\n", device->device_automount_hint ?
-                                                device->device_automount_hint : "" );
-    line[i++] = g_strdup_printf("  size:                        %" G_GUINT64_FORMAT "\n", device->device_size);
-    line[i++] = g_strdup_printf("  block size:                  %" G_GUINT64_FORMAT "\n", device->device_block_size);
-    line[i++] = g_strdup_printf("  usage:                       %s\n", device->id_usage ? device->id_usage : "" );
-    line[i++] = g_strdup_printf("  type:                        %s\n", device->id_type ? device->id_type : "" );
-    line[i++] = g_strdup_printf("  version:                     %s\n", device->id_version ? device->id_version : "" );
-    line[i++] = g_strdup_printf("  uuid:                        %s\n", device->id_uuid ? device->id_uuid : "" );
-    line[i++] = g_strdup_printf("  label:                       %s\n", device->id_label ? device->id_label : "" );
-    if (device->device_is_partition_table)
+gboolean device_classify( struct udev_device *udevice, device_class_t *dc )
+{
+    /* Answers the questions command_mount() asks most often from the udev
+     * properties already in memory, without reading sysfs through glib or
+     * building a device_t.  Nothing here allocates - strings are copied into
+     * the fixed buffers in dc and truncated if longer. */
+    const char *value;
+    const char *devnode;
+    const char *bus;
+    struct udev_device *parent;
+    gboolean has_id;
+    gboolean own_removable;
+
+    memset( dc, 0, sizeof( device_class_t ) );
+    dc->is_system_internal = TRUE;
+    if ( !udevice || !( devnode = udev_device_get_devnode( udevice ) ) )
+        return FALSE;
+    dc->is_block = !g_strcmp0( udev_device_get_subsystem( udevice ), "block" );
+
+    // info_device_properties() decides media availability from the device's
+    // own removable attribute, and only afterwards info_drive_connection()
+    // inherits it from the whole disk - follow the same order here
+    own_removable = ( value = udev_device_get_sysattr_value( udevice, "removable" ) )
+                                                            && atoi( value ) != 0;
+    for ( parent = udevice; parent && !dc->is_removable;
+                                parent = udev_device_get_parent( parent ) )
+    {
+        if ( ( value = udev_device_get_sysattr_value( parent, "removable" ) )
+                                                            && atoi( value ) != 0 )
+            dc->is_removable = TRUE;
+    }
+
+    // same extended partition exception as info_device_properties()
+    value = udev_device_get_property_value( udevice, "UDISKS_PARTITION_TYPE" );
+    has_id = FALSE;
+    if ( !( !g_strcmp0( udev_device_get_property_value( udevice,
+                                        "UDISKS_PARTITION_SCHEME" ), "mbr" ) &&
+            value && ( atoi( value ) == 0x05 || atoi( value ) == 0x0f ||
+                                                atoi( value ) == 0x85 ) ) )
     {
-        line[i++] = g_strdup_printf("  partition table:\n");
-        line[i++] = g_strdup_printf("    scheme:                    %s\n", device->partition_table_scheme ?
-                                                    device->partition_table_scheme : "" );
-        line[i++] = g_strdup_printf("    count:                     %s\n", device->partition_table_count ?
-                                                    device->partition_table_count : "0" );
+        if ( value = udev_device_get_property_value( udevice, "ID_FS_TYPE" ) )
+            g_strlcpy( dc->id_type, value, sizeof( dc->id_type ) );
+        if ( value = udev_device_get_property_value( udevice, "ID_FS_USAGE" ) )
+            g_strlcpy( dc->id_usage, value, sizeof( dc->id_usage ) );
+        has_id = dc->id_type[0] != '\0' || dc->id_usage[0] != '\0' ||
+                 ( ( value = udev_device_get_property_value( udevice, "ID_FS_UUID" ) )
+                                                        && value[0] != '\0' ) ||
+                 ( ( value = udev_device_get_property_value( udevice, "ID_FS_LABEL" ) )
+                                                        && value[0] != '\0' );
     }
-    if (device->device_is_partition)
+    dc->is_media_available = info_media_available( udevice, devnode,
+                                                    own_removable, has_id );
+
+    if ( dc->is_media_available &&
+                ( value = udev_device_get_sysattr_value( udevice, "size" ) ) )
+        dc->size = g_ascii_strtoull( value, NULL, 10 ) * ( (guint64) 512 );
+
+    // system internal - no connection interface is available here, so use
+    // the bus udev reports for the same hotplug buses
+    if ( value = udev_device_get_property_value( udevice, "UDISKS_SYSTEM_INTERNAL" ) )
+        dc->is_system_internal = atoi( value ) != 0;
+    else if ( dc->is_removable )
+        dc->is_system_internal = FALSE;
+    else if ( ( bus = udev_device_get_property_value( udevice, "ID_BUS" ) ) &&
+                    ( !strcmp( bus, "usb" ) || !strcmp( bus, "ieee1394" ) ) )
+        dc->is_system_internal = FALSE;
+    return TRUE;
+}
+
+static const char* devlink_dirs[DEVLINK_KINDS] = {
+    "/dev/disk/by-label/",
+    "/dev/disk/by-uuid/",
+    "/dev/disk/by-partuuid/",
+    "/dev/disk/by-id/"
+};
+
+devlink_index_t* devlink_index_new( struct udev *udev )
+{
+    /* One pass over the udev database indexes every /dev/disk/by-* name, so
+     * -L and -U lookups need neither a /dev/disk scan nor a readlink. */
+    struct udev_enumerate *enumerate;
+    struct udev_list_entry *entry;
+    struct udev_list_entry *link;
+    struct udev_device *udevice;
+    const char *devnode;
+    const char *name;
+    int kind;
+
+    enumerate = udev_enumerate_new( udev );
+    if ( !enumerate )
+        return NULL;
+    devlink_index_t *index = g_slice_new0( devlink_index_t );
+    for ( kind = 0; kind < DEVLINK_KINDS; kind++ )
+        index->names[kind] = g_hash_table_new_full( g_str_hash, g_str_equal,
+                                                            g_free, g_free );
+
+    udev_enumerate_add_match_subsystem( enumerate, "block" );
+    udev_enumerate_scan_devices( enumerate );
+    udev_list_entry_foreach( entry, udev_enumerate_get_list_entry( enumerate ) )
     {
-        line[i++] = g_strdup_printf("  partition:\n");
-        line[i++] = g_strdup_printf("    scheme:                    %s\n", device->partition_scheme ?
-                                                    device->partition_scheme : "" );
-        line[i++] = g_strdup_printf("    number:                    %s\n", device->partition_number ?
-                                                    device->partition_number : "" );
-        line[i++] = g_strdup_printf("    type:                      %s\n", device->partition_type ?
-                                                    device->partition_type : "" );
-        line[i++] = g_strdup_printf("    flags:                     %s\n", device->partition_flags ?
-                                                    device->partition_flags : "" );
-        line[i++] = g_strdup_printf("    offset:                    %s\n", device->partition_offset ?
-                                                    device->partition_offset : "" );
-        line[i++] = g_strdup_printf("    alignment offset:          %s\n", device->partition_alignment_offset ?
-                                                    device->partition_alignment_offset : "" );
-        line[i++] = g_strdup_printf("    size:                      %s\n", device->partition_size ?
-                                                    device->partition_size : "" );
-        line[i++] = g_strdup_printf("    label:                     %s\n", device->partition_label ?
-                                                    device->partition_label : "" );
-        line[i++] = g_strdup_printf("    uuid:                      %s\n", device->partition_uuid ?
-                                                    device->partition_uuid : "" );
+        udevice = udev_device_new_from_syspath( udev,
+                                            udev_list_entry_get_name( entry ) );
+        if ( !udevice )
+            continue;
+        if ( devnode = udev_device_get_devnode( udevice ) )
+        {
+            udev_list_entry_foreach( link,
+                                udev_device_get_devlinks_list_entry( udevice ) )
+            {
+                name = udev_list_entry_get_name( link );
+                for ( kind = 0; name && kind < DEVLINK_KINDS; kind++ )
+                {
+                    if ( g_str_has_prefix( name, devlink_dirs[kind] ) )
+                    {
+                        // link names are encoded like \x20 for space
+                        g_hash_table_replace( index->names[kind],
+                            decode_udev_encoded_string( name +
+                                                strlen( devlink_dirs[kind] ) ),
+                            g_strdup( devnode ) );
+                        break;
+                    }
+                }
+            }
+        }
+        udev_device_unref( udevice );
     }
-    if (device->device_is_optical_disc)
+    udev_enumerate_unref( enumerate );
+    return index;
+}
+
+const char* devlink_index_lookup( devlink_index_t *index, int kind,
+                                                        const char *name )
+{
+    if ( !index || !name || kind < 0 || kind >= DEVLINK_KINDS )
+        return NULL;
+    return (const char*)g_hash_table_lookup( index->names[kind], name );
+}
+
+void devlink_index_free( devlink_index_t *index )
+{
+    int kind;
+
+    if ( !index )
+        return;
+    for ( kind = 0; kind < DEVLINK_KINDS; kind++ )
+        g_hash_table_destroy( index->names[kind] );
+    g_slice_free( devlink_index_t, index );
+}
+
+/* device_show_info() output is driven by this table so that all formats
+ * show the same fields.  label is the udisks v1 text label, key is used
+ * for JSON and (uppercased) for KEY=value output.  Fields of a section are
+ * only shown when the device has that section. */
+enum {
+    INFO_STR,           // char*, fallback if NULL
+    INFO_BOOL,          // gboolean as 0/1 (JSON true/false)
+    INFO_UINT64,        // guint64
+    INFO_DEVNUM,        // major:minor
+    INFO_IFACE,         // char*, text shows (unknown) if empty
+    INFO_SPEED,         // guint64 bits/s, text shows (unknown) if zero
+    INFO_HEADING        // text only section heading
+};
+
+enum {
+    INFO_SECT_DEVICE,
+    INFO_SECT_PARTITION_TABLE,
+    INFO_SECT_PARTITION,
+    INFO_SECT_OPTICAL,
+    INFO_SECT_DRIVE
+};
+
+// field flags
+#define INFO_OPTIONAL   1   // omit if NULL
+#define INFO_TEXT_ONLY  2
+#define INFO_NO_TEXT    4
+#define INFO_SHELL      8   // included in DEVICE_INFO_SHELL (devmon) output
+
+typedef struct info_field_t {
+    const char *label;
+    const char *key;
+    int section;
+    int type;
+    glong offset;
+    const char *fallback;
+    int flags;
+} info_field_t;
+
+#define DOFF( member ) G_STRUCT_OFFSET( device_t, member )
+
+static const info_field_t info_fields[] = {
+    { "  native-path:",        "native_path",         INFO_SECT_DEVICE, INFO_STR,
+                            DOFF( native_path ), "", 0 },
+    { "  device:",             "device",              INFO_SECT_DEVICE, INFO_DEVNUM,
+                            0, "", 0 },
+    { "  device-file:",        "device_file",         INFO_SECT_DEVICE, INFO_STR,
+                            DOFF( devnode ), "", INFO_SHELL },
+    { "    presentation:",     "presentation",        INFO_SECT_DEVICE, INFO_STR,
+                            DOFF( devnode ), "", INFO_TEXT_ONLY },
+    { "    by-id:",            "by_id",               INFO_SECT_DEVICE, INFO_STR,
+                            DOFF( device_by_id ), "", INFO_OPTIONAL },
+    { "  system internal:",    "system_internal",     INFO_SECT_DEVICE, INFO_BOOL,
+                            DOFF( device_is_system_internal ), NULL, INFO_SHELL },
+    { "  removable:",          "removable",           INFO_SECT_DEVICE, INFO_BOOL,
+                            DOFF( device_is_removable ), NULL, 0 },
+    { "  has media:",          "has_media",           INFO_SECT_DEVICE, INFO_BOOL,
+                            DOFF( device_is_media_available ), NULL, INFO_SHELL },
+    { "  is read only:",       "is_read_only",        INFO_SECT_DEVICE, INFO_BOOL,
+                            DOFF( device_is_read_only ), NULL, 0 },
+    { "  is mounted:",         "is_mounted",          INFO_SECT_DEVICE, INFO_BOOL,
+                            DOFF( device_is_mounted ), NULL, INFO_SHELL },
+    { "  mount paths:",        "mount_paths",         INFO_SECT_DEVICE, INFO_STR,
+                            DOFF( mount_points ), "", 0 },
+    { "  presentation hide:",  "presentation_hide",   INFO_SECT_DEVICE, INFO_STR,
+                            DOFF( device_presentation_hide ), "0", 0 },
+    { "  presentation nopolicy:", "presentation_nopolicy", INFO_SECT_DEVICE, INFO_STR,
+                            DOFF( device_presentation_nopolicy ), "0", INFO_SHELL },
+    { "  presentation name:",  "presentation_name",   INFO_SECT_DEVICE, INFO_STR,
+                            DOFF( device_presentation_name ), "", 0 },
+    { "  presentation icon:",  "presentation_icon",   INFO_SECT_DEVICE, INFO_STR,
+                            DOFF( device_presentation_icon_name ), "", 0 },
+    { "  automount hint:",     "automount_hint",      INFO_SECT_DEVICE, INFO_STR,
+                            DOFF( device_automount_hint ), "", 0 },
+    { "  size:",               "size",                INFO_SECT_DEVICE, INFO_UINT64,
+                            DOFF( device_size ), NULL, 0 },
+    { "  block size:",         "block_size",          INFO_SECT_DEVICE, INFO_UINT64,
+                            DOFF( device_block_size ), NULL, 0 },
+    { "  usage:",              "usage",               INFO_SECT_DEVICE, INFO_STR,
+                            DOFF( id_usage ), "", INFO_SHELL },
+    { "  type:",               "type",                INFO_SECT_DEVICE, INFO_STR,
+                            DOFF( id_type ), "", INFO_SHELL },
+    { "  version:",            "version",             INFO_SECT_DEVICE, INFO_STR,
+                            DOFF( id_version ), "", 0 },
+    { "  uuid:",               "uuid",                INFO_SECT_DEVICE, INFO_STR,
+                            DOFF( id_uuid ), "", 0 },
+    { "  label:",              "label",               INFO_SECT_DEVICE, INFO_STR,
+                            DOFF( id_label ), "", INFO_SHELL },
+    { "  is partition table:", "is_partition_table",  INFO_SECT_DEVICE, INFO_BOOL,
+                            DOFF( device_is_partition_table ), NULL, INFO_NO_TEXT },
+    { "  is partition:",       "is_partition",        INFO_SECT_DEVICE, INFO_BOOL,
+                            DOFF( device_is_partition ), NULL, INFO_NO_TEXT | INFO_SHELL },
+    { "  is optical disc:",    "is_optical_disc",     INFO_SECT_DEVICE, INFO_BOOL,
+                            DOFF( device_is_optical_disc ), NULL, INFO_NO_TEXT | INFO_SHELL },
+    { "  is drive:",           "is_drive",            INFO_SECT_DEVICE, INFO_BOOL,
+                            DOFF( device_is_drive ), NULL, INFO_NO_TEXT },
+
+    { "  partition table:",    NULL,                  INFO_SECT_PARTITION_TABLE, INFO_HEADING,
+                            0, NULL, 0 },
+    { "    scheme:",           "partition_table_scheme", INFO_SECT_PARTITION_TABLE, INFO_STR,
+                            DOFF( partition_table_scheme ), "", 0 },
+    { "    count:",            "partition_table_count", INFO_SECT_PARTITION_TABLE, INFO_STR,
+                            DOFF( partition_table_count ), "0", 0 },
+
+    { "  partition:",          NULL,                  INFO_SECT_PARTITION, INFO_HEADING,
+                            0, NULL, 0 },
+    { "    scheme:",           "partition_scheme",    INFO_SECT_PARTITION, INFO_STR,
+                            DOFF( partition_scheme ), "", 0 },
+    { "    number:",           "partition_number",    INFO_SECT_PARTITION, INFO_STR,
+                            DOFF( partition_number ), "", 0 },
+    { "    type:",             "partition_type",      INFO_SECT_PARTITION, INFO_STR,
+                            DOFF( partition_type ), "", 0 },
+    { "    flags:",            "partition_flags",     INFO_SECT_PARTITION, INFO_STR,
+                            DOFF( partition_flags ), "", 0 },
+    { "    offset:",           "partition_offset",    INFO_SECT_PARTITION, INFO_STR,
+                            DOFF( partition_offset ), "", 0 },
+    { "    alignment offset:", "partition_alignment_offset", INFO_SECT_PARTITION, INFO_STR,
+                            DOFF( partition_alignment_offset ), "", 0 },
+    { "    size:",             "partition_size",      INFO_SECT_PARTITION, INFO_STR,
+                            DOFF( partition_size ), "", 0 },
+    { "    label:",            "partition_label",     INFO_SECT_PARTITION, INFO_STR,
+                            DOFF( partition_label ), "", 0 },
+    { "    uuid:",             "partition_uuid",      INFO_SECT_PARTITION, INFO_STR,
+                            DOFF( partition_uuid ), "", 0 },
+
+    { "  optical disc:",       NULL,                  INFO_SECT_OPTICAL, INFO_HEADING,
+                            0, NULL, 0 },
+    { "    blank:",            "optical_disc_blank",  INFO_SECT_OPTICAL, INFO_BOOL,
+                            DOFF( optical_disc_is_blank ), NULL, INFO_SHELL },
+    { "    appendable:",       "optical_disc_appendable", INFO_SECT_OPTICAL, INFO_BOOL,
+                            DOFF( optical_disc_is_appendable ), NULL, 0 },
+    { "    closed:",           "optical_disc_closed", INFO_SECT_OPTICAL, INFO_BOOL,
+                            DOFF( optical_disc_is_closed ), NULL, 0 },
+    { "    num tracks:",       "optical_disc_num_tracks", INFO_SECT_OPTICAL, INFO_STR,
+                            DOFF( optical_disc_num_tracks ), "0", 0 },
+    { "    num audio tracks:", "optical_disc_num_audio_tracks", INFO_SECT_OPTICAL, INFO_STR,
+                            DOFF( optical_disc_num_audio_tracks ), "0", INFO_SHELL },
+    { "    num sessions:",     "optical_disc_num_sessions", INFO_SECT_OPTICAL, INFO_STR,
+                            DOFF( optical_disc_num_sessions ), "0", 0 },
+
+    { "  drive:",              NULL,                  INFO_SECT_DRIVE, INFO_HEADING,
+                            0, NULL, 0 },
+    { "    vendor:",           "drive_vendor",        INFO_SECT_DRIVE, INFO_STR,
+                            DOFF( drive_vendor ), "", 0 },
+    { "    model:",            "drive_model",         INFO_SECT_DRIVE, INFO_STR,
+                            DOFF( drive_model ), "", 0 },
+    { "    revision:",         "drive_revision",      INFO_SECT_DRIVE, INFO_STR,
+                            DOFF( drive_revision ), "", 0 },
+    { "    serial:",           "drive_serial",        INFO_SECT_DRIVE, INFO_STR,
+                            DOFF( drive_serial ), "", 0 },
+    { "    WWN:",              "drive_wwn",           INFO_SECT_DRIVE, INFO_STR,
+                            DOFF( drive_wwn ), "", 0 },
+    { "    detachable:",       "drive_detachable",    INFO_SECT_DRIVE, INFO_BOOL,
+                            DOFF( drive_can_detach ), NULL, 0 },
+    { "    ejectable:",        "drive_ejectable",     INFO_SECT_DRIVE, INFO_BOOL,
+                            DOFF( drive_is_media_ejectable ), NULL, 0 },
+    { "    media:",            "drive_media",         INFO_SECT_DRIVE, INFO_STR,
+                            DOFF( drive_media ), "", INFO_SHELL },
+    { "      compat:",         "drive_media_compat",  INFO_SECT_DRIVE, INFO_STR,
+                            DOFF( drive_media_compatibility ), "", 0 },
+    { "    interface:",        "drive_interface",     INFO_SECT_DRIVE, INFO_IFACE,
+                            DOFF( drive_connection_interface ), "", 0 },
+    { "    if speed:",         "drive_if_speed",      INFO_SECT_DRIVE, INFO_SPEED,
+                            DOFF( drive_connection_speed ), NULL, 0 }
+};
+
+static gboolean info_has_section( device_t *device, int section )
+{
+    switch ( section )
     {
-        line[i++] = g_strdup_printf("  optical disc:\n");
-        line[i++] = g_strdup_printf("    blank:                     %d\n", device->optical_disc_is_blank);
-        line[i++] = g_strdup_printf("    appendable:                %d\n", device->optical_disc_is_appendable);
-        line[i++] = g_strdup_printf("    closed:                    %d\n", device->optical_disc_is_closed);
-        line[i++] = g_strdup_printf("    num tracks:                %s\n", device->optical_disc_num_tracks ?
-                                                    device->optical_disc_num_tracks : "0" );
-        line[i++] = g_strdup_printf("    num audio tracks:          %s\n", device->optical_disc_num_audio_tracks ?
-                                                    device->optical_disc_num_audio_tracks : "0" );
-        line[i++] = g_strdup_printf("    num sessions:              %s\n", device->optical_disc_num_sessions ?
-                                                    device->optical_disc_num_sessions : "0" );
+        case INFO_SECT_PARTITION_TABLE:
+            return device->device_is_partition_table;
+        case INFO_SECT_PARTITION:
+            return device->device_is_partition;
+        case INFO_SECT_OPTICAL:
+            return device->device_is_optical_disc;
+        case INFO_SECT_DRIVE:
+            return device->device_is_drive;
     }
-    if (device->device_is_drive)
+    return TRUE;
+}
+
+static void info_append_json_string( GString *buf, const char *str )
+{
+    const char *s;
+
+    g_string_append_c( buf, '"' );
+    for ( s = str; *s; s++ )
     {
-        line[i++] = g_strdup_printf("  drive:\n");
-        line[i++] = g_strdup_printf("    vendor:                    %s\n", device->drive_vendor ?
-                                                    device->drive_vendor : "" );
-        line[i++] = g_strdup_printf("    model:                     %s\n", device->drive_model ?
-                                                    device->drive_model : "" );
-        line[i++] = g_strdup_printf("    revision:                  %s\n", device->drive_revision ?
-                                                    device->drive_revision : "" );
-        line[i++] = g_strdup_printf("    serial:                    %s\n", device->drive_serial ?
-                                                    device->drive_serial : "" );
-        line[i++] = g_strdup_printf("    WWN:                       %s\n", device->drive_wwn ?
-                                                    device->drive_wwn : "" );
-        line[i++] = g_strdup_printf("    detachable:                %d\n", device->drive_can_detach);
-        line[i++] = g_strdup_printf("    ejectable:                 %d\n", device->drive_is_media_ejectable);
-        line[i++] = g_strdup_printf("    media:                     %s\n", device->drive_media ?
-                                                    device->drive_media : "" );
-        line[i++] = g_strdup_printf("      compat:                  %s\n", device->drive_media_compatibility ?
-                                                    device->drive_media_compatibility : "" );
-        if ( device->drive_connection_interface == NULL ||
-                                strlen (device->drive_connection_interface) == 0 )
-            line[i++] = g_strdup_printf("    interface:                 (unknown)\n");
+        if ( *s == '"' || *s == '\\' )
+        {
+            g_string_append_c( buf, '\\' );
+            g_string_append_c( buf, *s );
+        }
+        else if ( (guchar)*s < 0x20 )
+            g_string_append_printf( buf, "\\u%04x", (guchar)*s );
         else
-            line[i++] = g_strdup_printf("    interface:                 %s\n", device->drive_connection_interface);
-        if (device->drive_connection_speed == 0)
-            line[i++] = g_strdup_printf("    if speed:                  (unknown)\n");
+            g_string_append_c( buf, *s );
+    }
+    g_string_append_c( buf, '"' );
+}
+
+static void info_append_shell_string( GString *buf, const char *str )
+{
+    const char *s;
+
+    g_string_append_c( buf, '\'' );
+    for ( s = str; *s; s++ )
+    {
+        if ( *s == '\'' )
+            g_string_append( buf, "'\\''" );
+        else if ( (guchar)*s < 0x20 )
+            // keep each value on one line for line-based readers
+            g_string_append_c( buf, '?' );
         else
-            line[i++] = g_strdup_printf("    if speed:                  %" G_GINT64_FORMAT " bits/s\n",
-                                                    device->drive_connection_speed);
+            g_string_append_c( buf, *s );
     }
-    line[i] = NULL;
-    gchar* output = g_strjoinv( NULL, line );
-    i = 0;
-    while ( line[i] )
-        g_free( line[i++] );
-    return output;
+    g_string_append_c( buf, '\'' );
 }
 
+static void info_append_key( GString *buf, const char *key )
+{
+    for ( ; *key; key++ )
+        g_string_append_c( buf, g_ascii_toupper( *key ) );
+}
+
+void device_render_info( device_t *device, int format, GString *buf )
+{   // no translate
+    const info_field_t *field;
+    const char *str;
+    char num[64];
+    gboolean first = TRUE;
+    gboolean quote;
+    guint64 value;
+    int i;
+
+    if ( format == DEVICE_INFO_TEXT )
+    {
+        //g_string_append_printf( buf, "Showing information for %s\n", device->devnode );
+        str = strrchr( device->devnode, '/' );
+        g_string_append_printf( buf,
+                    "Showing information for /org/freedesktop/UDisks/devices/%s\n",
+                    str ? str + 1 : device->devnode );
+    }
+    else if ( format == DEVICE_INFO_JSON )
+        g_string_append_c( buf, '{' );
+
+    for ( i = 0; i < G_N_ELEMENTS( info_fields ); i++ )
+    {
+        field = &info_fields[i];
+        if ( format == DEVICE_INFO_SHELL )
+        {
+            if ( !( field->flags & INFO_SHELL ) )
+                continue;
+            if ( !first )
+                g_string_append_c( buf, ' ' );
+            first = FALSE;
+            if ( !info_has_section( device, field->section ) )
+            {
+                // always define the variable - empty as in unset
+                info_append_key( buf, field->key );
+                g_string_append( buf, "=''" );
+                continue;
+            }
+        }
+        else if ( !info_has_section( device, field->section ) ||
+                ( format == DEVICE_INFO_TEXT && ( field->flags & INFO_NO_TEXT ) ) ||
+                ( format != DEVICE_INFO_TEXT && ( field->flags & INFO_TEXT_ONLY ||
+                                                  field->type == INFO_HEADING ) ) )
+            continue;
+        if ( field->type == INFO_HEADING )
+        {
+            g_string_append_printf( buf, "%s\n", field->label );
+            continue;
+        }
+
+        // get value as string
+        str = num;
+        quote = TRUE;
+        switch ( field->type )
+        {
+            case INFO_STR:
+            case INFO_IFACE:
+                str = G_STRUCT_MEMBER( char*, device, field->offset );
+                if ( !str && ( field->flags & INFO_OPTIONAL ) )
+                    continue;
+                if ( field->type == INFO_IFACE && format == DEVICE_INFO_TEXT
+                                                    && !( str && str[0] != '\0' ) )
+                    str = "(unknown)";
+                else if ( !str )
+                    str = field->fallback;
+                break;
+            case INFO_BOOL:
+                if ( format == DEVICE_INFO_JSON )
+                    str = G_STRUCT_MEMBER( gboolean, device, field->offset ) ?
+                                                                "true" : "false";
+                else
+                    str = G_STRUCT_MEMBER( gboolean, device, field->offset ) ?
+                                                                "1" : "0";
+                quote = FALSE;
+                break;
+            case INFO_UINT64:
+            case INFO_SPEED:
+                value = G_STRUCT_MEMBER( guint64, device, field->offset );
+                quote = FALSE;
+                if ( field->type == INFO_SPEED && format == DEVICE_INFO_TEXT )
+                {
+                    if ( value == 0 )
+                        str = "(unknown)";
+                    else
+                        g_snprintf( num, sizeof( num ), "%" G_GUINT64_FORMAT " bits/s",
+                                                                            value );
+                }
+                else
+                    g_snprintf( num, sizeof( num ), "%" G_GUINT64_FORMAT, value );
+                break;
+            case INFO_DEVNUM:
+                g_snprintf( num, sizeof( num ), "%s:%s", device->major, device->minor );
+                break;
+        }
+
+        switch ( format )
+        {
+            case DEVICE_INFO_JSON:
+                if ( !first )
+                    g_string_append_c( buf, ',' );
+                info_append_json_string( buf, field->key );
+                g_string_append_c( buf, ':' );
+                if ( quote )
+                    info_append_json_string( buf, str );
+                else
+                    g_string_append( buf, str );
+                break;
+            case DEVICE_INFO_KEYS:
+            case DEVICE_INFO_SHELL:
+                info_append_key( buf, field->key );
+                g_string_append_c( buf, '=' );
+                info_append_shell_string( buf, str );
+                if ( format == DEVICE_INFO_KEYS )
+                    g_string_append_c( buf, '\n' );
+                break;
+            default:
+                g_string_append_printf( buf, "%-31s%s\n", field->label, str );
+        }
+        first = FALSE;
+    }
+
+    if ( format == DEVICE_INFO_JSON )
+        g_string_append( buf, "}\n" );
+    else if ( format == DEVICE_INFO_SHELL )
+        g_string_append_c( buf, '\n' );
+}
+
+char* device_show_info( device_t *device, int format )
+{
+    GString *buf = g_string_sized_new( 2048 );
+    device_render_info( device, format, buf );
+    return g_string_free( buf, FALSE );
+}
+
+
+#ifdef TEST_PROGRAM_DEVICE_CLASSIFY
+/* compares device_classify() against device_get_info() over the block devices
+ * present, cycling through them until the requested number of lookups is done
+ *   gcc -DTEST_PROGRAM_DEVICE_CLASSIFY device-info.c \
+ *       $(pkg-config --cflags --libs glib-2.0 libudev)
+ */
+#include <time.h>
+
+static double elapsed_ms( struct timespec *start )
+{
+    struct timespec now;
+    clock_gettime( CLOCK_MONOTONIC, &now );
+    return ( now.tv_sec - start->tv_sec ) * 1000.0 +
+                                ( now.tv_nsec - start->tv_nsec ) / 1000000.0;
+}
+
+int main( int argc, char **argv )
+{
+    struct udev *udev;
+    struct udev_enumerate *enumerate;
+    struct udev_list_entry *entry;
+    struct udev_device *udevice;
+    GPtrArray *devices;
+    device_class_t dc;
+    device_t *device;
+    struct timespec start;
+    double classify_ms, info_ms;
+    int count = argc > 1 ? atoi( argv[1] ) : 1000;
+    int i;
+
+    if ( count < 1 || !( udev = udev_new() ) )
+    {
+        fprintf( stderr, "usage: %s [LOOKUPS]\n", argv[0] );
+        return EXIT_FAILURE;
+    }
+    devices = g_ptr_array_new();
+    enumerate = udev_enumerate_new( udev );
+    udev_enumerate_add_match_subsystem( enumerate, "block" );
+    udev_enumerate_scan_devices( enumerate );
+    udev_list_entry_foreach( entry, udev_enumerate_get_list_entry( enumerate ) )
+    {
+        if ( udevice = udev_device_new_from_syspath( udev,
+                                        udev_list_entry_get_name( entry ) ) )
+            g_ptr_array_add( devices, udevice );
+    }
+    udev_enumerate_unref( enumerate );
+    if ( devices->len == 0 )
+    {
+        fprintf( stderr, "%s: no block devices found\n", argv[0] );
+        return EXIT_FAILURE;
+    }
+
+    clock_gettime( CLOCK_MONOTONIC, &start );
+    for ( i = 0; i < count; i++ )
+        device_classify( devices->pdata[i % devices->len], &dc );
+    classify_ms = elapsed_ms( &start );
+
+    clock_gettime( CLOCK_MONOTONIC, &start );
+    for ( i = 0; i < count; i++ )
+    {
+        device = device_alloc( devices->pdata[i % devices->len] );
+        device_get_info( device, NULL );
+        device_free( device );
+    }
+    info_ms = elapsed_ms( &start );
+
+    printf( "%d lookups over %u devices\n", count, devices->len );
+    printf( "device_classify:  %10.3f ms  %8.2f us/device\n", classify_ms,
+                                                classify_ms * 1000.0 / count );
+    printf( "device_get_info:  %10.3f ms  %8.2f us/device\n", info_ms,
+                                                info_ms * 1000.0 / count );
+
+    for ( i = 0; i < devices->len; i++ )
+        udev_device_unref( devices->pdata[i] );
+    g_ptr_array_free( devices, TRUE );
+    udev_unref( udev );
+    return EXIT_SUCCESS;
+}
+#endif
@@ -91,9 +91,51 @@ typedef struct devmount_t {
     GList* mounts;
 } devmount_t;
 
+// device_show_info() formats
+enum {
+    DEVICE_INFO_TEXT,       // udisks v1 compatible
+    DEVICE_INFO_JSON,
+    DEVICE_INFO_KEYS,       // shell-quoted KEY=value lines
+    DEVICE_INFO_SHELL       // one line of KEY=value for the fields devmon uses
+};
+
+// devlink index kinds - /dev/disk/by-*
+enum {
+    DEVLINK_LABEL,
+    DEVLINK_UUID,
+    DEVLINK_PARTUUID,
+    DEVLINK_ID,
+    DEVLINK_KINDS
+};
+
+typedef struct devlink_index_t {
+    GHashTable* names[DEVLINK_KINDS];   // decoded link name -> devnode
+} devlink_index_t;
+
+// slim classification read from a few udev properties - no heap allocation
+typedef struct device_class_t {
+    gboolean is_block;
+    gboolean is_system_internal;
+    gboolean is_removable;
+    gboolean is_media_available;
+    guint64 size;
+    char id_type[32];
+    char id_usage[32];
+} device_class_t;
+
 device_t *device_alloc( struct udev_device *udevice );
 void device_free( device_t *device );
 gboolean device_get_info( device_t *device, GList* devmounts );
-char* device_show_info( device_t *device );
+void device_render_info( device_t *device, int format, GString *buf );
+char* device_show_info( device_t *device, int format );
+gboolean device_probe_optical( device_t *device );
+gboolean device_classify( struct udev_device *udevice, device_class_t *dc );
+devlink_index_t* devlink_index_new( struct udev *udev );
+const char* devlink_index_lookup( devlink_index_t *index, int kind,
+                                                        const char *name );
+void devlink_index_free( devlink_index_t *index );
+gboolean read_file_contents( const char *path, gchar **contents, GError **error );
+
+extern unsigned long file_reads;    // files read, for udevil's timings
 
 #endif
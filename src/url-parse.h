@@ -0,0 +1,33 @@
+#ifndef URL_PARSE_H
+#define URL_PARSE_H
+
+#include <stddef.h>
+
+// a field of a parsed url - points into the original string
+typedef struct url_span_t {
+    const char* s;      // NULL if the field is absent
+    size_t len;
+} url_span_t;
+
+typedef struct url_parts_t {
+    url_span_t scheme;  // up to the first :, if the url has one
+    url_span_t rest;    // all after the scheme and leading slashes
+    url_span_t user;
+    url_span_t pass;
+    url_span_t host;    // without [] for an IPv6 literal
+    url_span_t port;
+    url_span_t path;    // from the first / after the host
+    int ipv6;           // host was a [literal]
+} url_parts_t;
+
+enum {
+    URL_OK = 0,
+    URL_BAD_HOST,       // unbalanced or misplaced [ ]
+    URL_BAD_PORT,       // port is not numeric
+    URL_DUP_FIELD       // more than two @, or more than one host :
+};
+
+extern int url_split( const char* url, int has_scheme, url_parts_t* parts );
+extern int url_decode( const url_span_t* span, char* out );
+
+#endif /* URL_PARSE_H */